@@ -1,11 +1,22 @@
 #include "clavata.h"
 
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
 #include <iostream>
+#include <unordered_set>
 using std::make_shared;
 using std::move;
 #include <cassert>
 #define CLVT_ASSERT(expr) assert(expr)
 
+#if defined(__GNUC__) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#define CLVT_SIMD
+#endif
+
 namespace clavata {
 
 template <JSON::Type ty, typename T>
@@ -21,17 +32,70 @@ class Value : public JSONValue {
         // std::cout << "Value type is " << (int)ty << std::endl;
         return ty;
     }
+
+    bool equals(const JSONValue *other) const override {
+        return m_value == static_cast<const Value *>(other)->m_value;
+    }
+};
+
+/**
+ * from boost
+ * mix hash value v into seed
+ */
+static inline size_t hash_combine(size_t seed, size_t v) {
+    return seed ^ (v + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+/**
+ * arrays and objects never change after construction, so their hash is
+ * computed on first use and cached in the node.
+ */
+template <JSON::Type ty, typename T>
+class Container : public Value<ty, T> {
+   protected:
+    // 0 means not computed yet
+    mutable std::atomic<size_t> m_hash{0};
+    using Value<ty, T>::Value;
+
+    virtual size_t compute_hash() const = 0;
+
+    size_t hash() const override {
+        size_t h = m_hash.load(std::memory_order_relaxed);
+        if (h == 0) {
+            h = compute_hash();
+            if (h == 0) h = 1;
+            m_hash.store(h, std::memory_order_relaxed);
+        }
+        return h;
+    }
+
+    bool equals(const JSONValue *other) const override {
+        auto o = static_cast<const Container *>(other);
+        // different cached hashes save the deep comparison
+        size_t h1 = m_hash.load(std::memory_order_relaxed);
+        size_t h2 = o->m_hash.load(std::memory_order_relaxed);
+        if (h1 && h2 && h1 != h2) return false;
+        return this->m_value == o->m_value;
+    }
 };
 
 // for JSON null
-struct NullStruct {};
+struct NullStruct {
+    bool operator==(const NullStruct &) const { return true; }
+};
 class ClvtNull final : public Value<JSON::kNULL, NullStruct> {
+    size_t hash() const override { return JSON::kNULL; }
+
    public:
     explicit ClvtNull() : Value({}) {}
 };
 
 class ClvtNumber final : public Value<JSON::kNUMBER, double> {
     double number_value() const override { return m_value; }
+    size_t hash() const override {
+        // 0.0 == -0.0, so they must hash the same
+        return m_value == 0 ? 0 : std::hash<double>()(m_value);
+    }
 
    public:
     explicit ClvtNumber(double d) : Value(d) {}
@@ -39,6 +103,7 @@ class ClvtNumber final : public Value<JSON::kNUMBER, double> {
 
 class ClvtBool final : public Value<JSON::kBOOL, bool> {
     bool bool_value() const override { return m_value; }
+    size_t hash() const override { return m_value ? 1231 : 1237; }
 
    public:
     explicit ClvtBool(bool b) : Value(b) {
@@ -48,28 +113,31 @@ class ClvtBool final : public Value<JSON::kBOOL, bool> {
 
 class ClvtString final : public Value<JSON::kSTRING, string> {
     const string &string_value() const override { return m_value; }
+    size_t hash() const override { return std::hash<string>()(m_value); }
 
    public:
     explicit ClvtString(const string &s) : Value(s) {}
     explicit ClvtString(string &&s) : Value(move(s)) {}
 };
 
-class ClvtArray final : public Value<JSON::kARRAY, JSON::array> {
+class ClvtArray final : public Container<JSON::kARRAY, JSON::array> {
     const JSON::array &array_items() const override { return m_value; }
     const JSON &operator[](size_t) const override;
+    size_t compute_hash() const override;
 
    public:
-    explicit ClvtArray(const JSON::array &a) : Value(a) {}
-    explicit ClvtArray(JSON::array &&a) : Value(move(a)) {}
+    explicit ClvtArray(const JSON::array &a) : Container(a) {}
+    explicit ClvtArray(JSON::array &&a) : Container(move(a)) {}
 };
 
-class ClvtObject final : public Value<JSON::kOBJECT, JSON::object> {
+class ClvtObject final : public Container<JSON::kOBJECT, JSON::object> {
     const JSON::object &object_items() const override { return m_value; }
     const JSON &operator[](const string &) const override;
+    size_t compute_hash() const override;
 
    public:
-    explicit ClvtObject(const JSON::object &o) : Value(o) {}
-    explicit ClvtObject(JSON::object &&o) : Value(move(o)) {}
+    explicit ClvtObject(const JSON::object &o) : Container(o) {}
+    explicit ClvtObject(JSON::object &&o) : Container(move(o)) {}
 };
 
 struct Statics {
@@ -116,6 +184,13 @@ const JSON::object &JSON::object_items() const { return m->object_items(); }
 const JSON &JSON::operator[](size_t i) const { return (*m)[i]; }
 const JSON &JSON::operator[](const string &key) const { return (*m)[key]; }
 
+bool JSON::operator==(const JSON &rhs) const {
+    if (m == rhs.m) return true;
+    if (m->type() != rhs.m->type()) return false;
+    return m->equals(rhs.m.get());
+}
+size_t JSON::hash() const { return m->hash(); }
+
 double JSONValue::number_value() const { return 0; }
 bool JSONValue::bool_value() const { return false; }
 const string &JSONValue::string_value() const { return statics().empty_string; }
@@ -139,6 +214,20 @@ const JSON &ClvtObject::operator[](const string &key) const {
     return iter == m_value.end() ? statics_null() : iter->second;
 }
 
+size_t ClvtArray::compute_hash() const {
+    size_t h = JSON::kARRAY;
+    for (auto &j : m_value) h = hash_combine(h, j.hash());
+    return h;
+}
+size_t ClvtObject::compute_hash() const {
+    size_t h = JSON::kOBJECT;
+    for (auto &kv : m_value) {
+        h = hash_combine(h, std::hash<string>()(kv.first));
+        h = hash_combine(h, kv.second.hash());
+    }
+    return h;
+}
+
 #define in_range(c, s, e) (s <= c && c <= e)
 #define IS_DIGIT(c) in_range(c, '0', '9')
 #define IS_INTEGER(c) in_range(c, '1', '9')
@@ -159,37 +248,522 @@ static inline string format_char(char c) {
 #define is_hex(ch) \
     (in_range(ch, '0', '9') || in_range(ch, 'A', 'F') || in_range(ch, 'a', 'f'))
 
+/**
+ * find the first byte in s[i, n) that is `"` or `\`, return n if there is
+ * none. 32 (AVX2) or 16 (SSE2) bytes are classified at a time where available.
+ */
+static inline size_t scan_string(const char *s, size_t i, size_t n) {
+#ifdef CLVT_SIMD
+#ifdef __AVX2__
+    const __m256i q32 = _mm256_set1_epi8('"');
+    const __m256i b32 = _mm256_set1_epi8('\\');
+    for (; i + 32 <= n; i += 32) {
+        __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+        unsigned mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, q32),
+                                                 _mm256_cmpeq_epi8(v, b32))));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+#endif
+    const __m128i q16 = _mm_set1_epi8('"');
+    const __m128i b16 = _mm_set1_epi8('\\');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, q16), _mm_cmpeq_epi8(v, b16))));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+#endif
+    for (; i < n; i++)
+        if (s[i] == '"' || s[i] == '\\') return i;
+    return n;
+}
+
+/**
+ * length of the well-formed UTF-8 sequence starting at s[0] (a byte >= 0x80)
+ * with n bytes available, or 0 if it is ill-formed. overlong forms,
+ * surrogates and code points above U+10FFFF are rejected.
+ */
+static inline size_t utf8_sequence(const uint8_t *s, size_t n) {
+    uint8_t c = s[0];
+    size_t len;
+    uint8_t lo = 0x80, hi = 0xBF;  // range of the second byte
+    if (c < 0xC2) {
+        return 0;
+    } else if (c < 0xE0) {
+        len = 2;
+    } else if (c < 0xF0) {
+        len = 3;
+        if (c == 0xE0) lo = 0xA0;
+        if (c == 0xED) hi = 0x9F;
+    } else if (c < 0xF5) {
+        len = 4;
+        if (c == 0xF0) lo = 0x90;
+        if (c == 0xF4) hi = 0x8F;
+    } else {
+        return 0;
+    }
+    if (n < len) return 0;
+    if (!in_range(s[1], lo, hi)) return 0;
+    for (size_t a = 2; a < len; a++)
+        if ((s[a] & 0xC0) != 0x80) return 0;
+    return len;
+}
+
+/**
+ * same as scan_string, and set bad if s[i, end) is not well-formed UTF-8.
+ * scalar version, used when no vector instructions are available.
+ */
+static inline size_t scan_string_utf8_scalar(const char *s, size_t i,
+                                             size_t n, bool &bad) {
+    size_t end = scan_string(s, i, n);
+    auto u = reinterpret_cast<const uint8_t *>(s);
+    while (i < end) {
+        if (u[i] < 0x80) {
+            i++;
+            continue;
+        }
+        size_t len = utf8_sequence(u + i, end - i);
+        if (len == 0) {
+            bad = true;
+            break;
+        }
+        i += len;
+    }
+    return end;
+}
+
+#ifdef CLVT_SIMD
+/**
+ * vectorized UTF-8 validation, the lookup algorithm from Keiser & Lemire,
+ * "Validating UTF-8 In Less Than One Instruction Per Byte" (2021).
+ * every byte is looked up in three 16-entry tables, by the high and low
+ * nibble of the byte before it and by its own high nibble. the and of the
+ * three results is non-zero for any error that shows within two bytes.
+ * the third and fourth bytes of long sequences are checked apart.
+ * it runs in the same loop that looks for the end of the string, bytes from
+ * the `"` or `\` on are zeroed so they cannot affect the result.
+ */
+#define UTF8_TOO_SHORT (1 << 0)   // lead byte without enough continuations
+#define UTF8_TOO_LONG (1 << 1)    // ASCII followed by a continuation
+#define UTF8_OVERLONG_3 (1 << 2)  // 11100000 100_____
+#define UTF8_TOO_LARGE (1 << 3)   // above U+10FFFF
+#define UTF8_SURROGATE (1 << 4)   // 11101101 101_____
+#define UTF8_OVERLONG_2 (1 << 5)  // 1100000_ 10______
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6)  // 11110000 1000____
+#define UTF8_TWO_CONTS (1 << 7)   // two continuations in a row
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+// indexed by the high nibble of the previous byte
+alignas(16) static const uint8_t utf8_byte_1_high[16] = {
+    // 0_______ ________, ASCII
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    // 10______ ________, continuation
+    UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+    // 1100____ ________
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+    // 1101____ ________
+    UTF8_TOO_SHORT,
+    // 1110____ ________
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+    // 1111____ ________
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4};
+
+// indexed by the low nibble of the previous byte
+alignas(16) static const uint8_t utf8_byte_1_low[16] = {
+    // ____0000 ________
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+    // ____0001 ________
+    UTF8_CARRY | UTF8_OVERLONG_2,
+    // ____001_ ________
+    UTF8_CARRY, UTF8_CARRY,
+    // ____0100 ________
+    UTF8_CARRY | UTF8_TOO_LARGE,
+    // ____0101 ________ to ____1100 ________
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    // ____1101 ________
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+    // ____111_ ________
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000};
+
+// indexed by the high nibble of the current byte
+alignas(16) static const uint8_t utf8_byte_2_high[16] = {
+    // ________ 0_______, ASCII
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    // ________ 1000____
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 |
+        UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+    // ________ 1001____
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 |
+        UTF8_TOO_LARGE,
+    // ________ 101_____
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE |
+        UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE |
+        UTF8_TOO_LARGE,
+    // ________ 11______
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT};
+
+// a block ending in these bytes (last 3) is in the middle of a sequence
+alignas(32) static const uint8_t utf8_incomplete[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1};
+
+// loaded at prefix_mask + 32 - p, keeps the first p bytes of a block
+static const uint8_t prefix_mask[64] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+#ifdef __AVX2__
+static inline __m256i utf8_check32(__m256i v, __m256i prev) {
+    const __m256i lo4 = _mm256_set1_epi8(0x0F);
+    auto table = [](const uint8_t *t) {
+        return _mm256_broadcastsi128_si256(
+            _mm_load_si128(reinterpret_cast<const __m128i *>(t)));
+    };
+    // prev_k holds the byte k positions before each byte of v
+    __m256i shifted = _mm256_permute2x128_si256(prev, v, 0x21);
+    __m256i prev1 = _mm256_alignr_epi8(v, shifted, 15);
+    __m256i prev2 = _mm256_alignr_epi8(v, shifted, 14);
+    __m256i prev3 = _mm256_alignr_epi8(v, shifted, 13);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(
+                table(utf8_byte_1_high),
+                _mm256_and_si256(_mm256_srli_epi16(prev1, 4), lo4)),
+            _mm256_shuffle_epi8(table(utf8_byte_1_low),
+                                _mm256_and_si256(prev1, lo4))),
+        _mm256_shuffle_epi8(table(utf8_byte_2_high),
+                            _mm256_and_si256(_mm256_srli_epi16(v, 4), lo4)));
+    // the 3rd and 4th bytes after a lead must be continuations
+    __m256i must23 = _mm256_or_si256(
+        _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xE0 - 0x80)),
+        _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xF0 - 0x80)));
+    __m256i must23_80 = _mm256_and_si256(
+        must23, _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must23_80, special);
+}
+
+static size_t scan_string_utf8(const char *s, size_t i, size_t n,
+                               bool &bad) {
+    const __m256i q = _mm256_set1_epi8('"');
+    const __m256i b = _mm256_set1_epi8('\\');
+    __m256i prev = _mm256_setzero_si256(), err = _mm256_setzero_si256();
+    alignas(32) char tail[32];
+    for (; i < n; i += 32) {
+        const char *p = s + i;
+        if (n - i < 32) {
+            // zero padded, so the tail runs through the same code
+            memset(tail, 0, sizeof tail);
+            memcpy(tail, p, n - i);
+            p = tail;
+        }
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        unsigned mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, q),
+                                                 _mm256_cmpeq_epi8(v, b))));
+        if (mask) {
+            unsigned end = __builtin_ctz(mask);
+            v = _mm256_and_si256(v, _mm256_loadu_si256(
+                                        reinterpret_cast<const __m256i *>(
+                                            prefix_mask + 32 - end)));
+            err = _mm256_or_si256(err, utf8_check32(v, prev));
+            bad = !_mm256_testz_si256(err, err);
+            return i + end;
+        }
+        if (_mm256_movemask_epi8(v) == 0)
+            // all ASCII, only the previous block can be wrong
+            err = _mm256_or_si256(
+                err, _mm256_subs_epu8(
+                         prev, _mm256_load_si256(
+                                   reinterpret_cast<const __m256i *>(
+                                       utf8_incomplete))));
+        else
+            err = _mm256_or_si256(err, utf8_check32(v, prev));
+        prev = v;
+    }
+    // the end of the input, nothing may be left open
+    err = _mm256_or_si256(err, utf8_check32(_mm256_setzero_si256(), prev));
+    bad = !_mm256_testz_si256(err, err);
+    return n;
+}
+#else
+// SSSE3 is needed for the table lookups, check for it at runtime if the
+// compiler may not assume it
+#ifdef __SSSE3__
+#define CLVT_SSSE3
+#else
+#define CLVT_SSSE3 __attribute__((target("ssse3")))
+#endif
+
+CLVT_SSSE3 static inline __m128i utf8_check16(__m128i v, __m128i prev) {
+    const __m128i lo4 = _mm_set1_epi8(0x0F);
+    auto table = [](const uint8_t *t) {
+        return _mm_load_si128(reinterpret_cast<const __m128i *>(t));
+    };
+    // prev_k holds the byte k positions before each byte of v
+    __m128i prev1 = _mm_alignr_epi8(v, prev, 15);
+    __m128i prev2 = _mm_alignr_epi8(v, prev, 14);
+    __m128i prev3 = _mm_alignr_epi8(v, prev, 13);
+    __m128i special = _mm_and_si128(
+        _mm_and_si128(
+            _mm_shuffle_epi8(table(utf8_byte_1_high),
+                             _mm_and_si128(_mm_srli_epi16(prev1, 4), lo4)),
+            _mm_shuffle_epi8(table(utf8_byte_1_low),
+                             _mm_and_si128(prev1, lo4))),
+        _mm_shuffle_epi8(table(utf8_byte_2_high),
+                         _mm_and_si128(_mm_srli_epi16(v, 4), lo4)));
+    // the 3rd and 4th bytes after a lead must be continuations
+    __m128i must23 =
+        _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80)),
+                     _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80)));
+    __m128i must23_80 =
+        _mm_and_si128(must23, _mm_set1_epi8(static_cast<char>(0x80)));
+    return _mm_xor_si128(must23_80, special);
+}
+
+CLVT_SSSE3 static size_t scan_string_utf8_ssse3(const char *s, size_t i,
+                                                size_t n, bool &bad) {
+    const __m128i q = _mm_set1_epi8('"');
+    const __m128i b = _mm_set1_epi8('\\');
+    const __m128i zero = _mm_setzero_si128();
+    __m128i prev = zero, err = zero;
+    alignas(16) char tail[16];
+    for (; i < n; i += 16) {
+        const char *p = s + i;
+        if (n - i < 16) {
+            // zero padded, so the tail runs through the same code
+            memset(tail, 0, sizeof tail);
+            memcpy(tail, p, n - i);
+            p = tail;
+        }
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, b))));
+        if (mask) {
+            unsigned end = __builtin_ctz(mask);
+            v = _mm_and_si128(v, _mm_loadu_si128(
+                                     reinterpret_cast<const __m128i *>(
+                                         prefix_mask + 32 - end)));
+            err = _mm_or_si128(err, utf8_check16(v, prev));
+            bad = _mm_movemask_epi8(_mm_cmpeq_epi8(err, zero)) != 0xFFFF;
+            return i + end;
+        }
+        if (_mm_movemask_epi8(v) == 0)
+            // all ASCII, only the previous block can be wrong
+            err = _mm_or_si128(
+                err, _mm_subs_epu8(prev, _mm_load_si128(
+                                             reinterpret_cast<const __m128i *>(
+                                                 utf8_incomplete + 16))));
+        else
+            err = _mm_or_si128(err, utf8_check16(v, prev));
+        prev = v;
+    }
+    // the end of the input, nothing may be left open
+    err = _mm_or_si128(err, utf8_check16(zero, prev));
+    bad = _mm_movemask_epi8(_mm_cmpeq_epi8(err, zero)) != 0xFFFF;
+    return n;
+}
+
+static size_t scan_string_utf8(const char *s, size_t i, size_t n,
+                               bool &bad) {
+#ifndef __SSSE3__
+    static const bool ssse3 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3") != 0;
+    }();
+    if (!ssse3) return scan_string_utf8_scalar(s, i, n, bad);
+#endif
+    return scan_string_utf8_ssse3(s, i, n, bad);
+}
+#endif  // __AVX2__
+#else
+static inline size_t scan_string_utf8(const char *s, size_t i, size_t n,
+                                      bool &bad) {
+    return scan_string_utf8_scalar(s, i, n, bad);
+}
+#endif  // CLVT_SIMD
+
 struct ClvtParser final {
-    const string &src;
+    // the input, it need not be terminated: read it through at()
+    const char *src;
+    size_t src_len;
     size_t i;
     bool failed;
-    string &err;
+    string err;
+    bool hash_cons;
+    bool validate_utf8;
+    /**
+     * hash and equality of the hash-cons pool. unlike JSON::operator==,
+     * numbers compare bit by bit so that 0.0 and -0.0 stay apart, and
+     * children are compared by identity since they are interned first.
+     */
+    struct InternHash {
+        size_t operator()(const JSON &j) const {
+            size_t h = j.type();
+            switch (j.type()) {
+                case JSON::kNUMBER: {
+                    double d = j.number_value();
+                    uint64_t bits;
+                    memcpy(&bits, &d, sizeof bits);
+                    return std::hash<uint64_t>()(bits);
+                }
+                case JSON::kSTRING:
+                    return std::hash<string>()(j.string_value());
+                case JSON::kARRAY:
+                    for (auto &c : j.array_items()) h = hash_combine(h, id(c));
+                    return h;
+                case JSON::kOBJECT:
+                    for (auto &kv : j.object_items()) {
+                        h = hash_combine(h, std::hash<string>()(kv.first));
+                        h = hash_combine(h, id(kv.second));
+                    }
+                    return h;
+                default:
+                    return id(j);
+            }
+        }
+        static size_t id(const JSON &j) {
+            return std::hash<JSONValue *>()(j.m.get());
+        }
+    };
+    struct InternEqual {
+        bool operator()(const JSON &a, const JSON &b) const {
+            if (a.m == b.m) return true;
+            if (a.type() != b.type()) return false;
+            switch (a.type()) {
+                case JSON::kNUMBER: {
+                    double x = a.number_value(), y = b.number_value();
+                    return memcmp(&x, &y, sizeof x) == 0;
+                }
+                case JSON::kSTRING:
+                    return a.string_value() == b.string_value();
+                case JSON::kARRAY: {
+                    auto &x = a.array_items(), &y = b.array_items();
+                    if (x.size() != y.size()) return false;
+                    for (size_t k = 0; k < x.size(); k++)
+                        if (x[k].m != y[k].m) return false;
+                    return true;
+                }
+                case JSON::kOBJECT: {
+                    auto &x = a.object_items(), &y = b.object_items();
+                    if (x.size() != y.size()) return false;
+                    for (auto p = x.begin(), q = y.begin(); p != x.end();
+                         ++p, ++q)
+                        if (p->first != q->first || p->second.m != q->second.m)
+                            return false;
+                    return true;
+                }
+                default:
+                    // null and booleans are shared already
+                    return false;
+            }
+        }
+    };
+    // values already produced in this document, see JSON::kPARSE_HASH_CONS
+    std::unordered_set<JSON, InternHash, InternEqual> pool;
+    // scratch kept across documents: the string being decoded and the
+    // elements of all arrays being parsed
+    string buf;
+    vector<JSON> stack;
+
+    explicit ClvtParser(int opts)
+        : src(""),
+          src_len(0),
+          i(0),
+          failed(false),
+          hash_cons((opts & JSON::kPARSE_HASH_CONS) != 0),
+          validate_utf8((opts & JSON::kPARSE_VALIDATE_UTF8) != 0) {}
+
+    /**
+     * parse the whole document in[0, n).
+     * only per-document state is reset, scratch buffers keep their capacity.
+     */
+    JSON parse_document(const char *in, size_t n) {
+        src = in;
+        src_len = n;
+        i = 0;
+        failed = false;
+        err.clear();
+        JSON res = parse_json();
+        skip_whitespace();
+        if (!failed && i != src_len) fail("unexpected trailing charactors.");
+        reset_pool();
+        if (failed) {
+            stack.clear();
+            return JSON();
+        }
+        return res;
+    }
+
+    /**
+     * drop this document's values from the pool. clear() walks every
+     * bucket and the bucket array never shrinks, so one big document would
+     * slow down the reset of every later one: start over with a new pool.
+     */
+    void reset_pool() {
+        if (pool.bucket_count() > 64)
+            decltype(pool)().swap(pool);
+        else if (!pool.empty())
+            pool.clear();
+    }
+
+    // src[k], or '\0' past the end of the input
+    char at(size_t k) const { return k < src_len ? src[k] : '\0'; }
+
     void fail(string msg) {
         failed = true;
         err = msg;
     }
+    /**
+     * return the value identical to j that was parsed before, or remember j.
+     */
+    JSON intern(JSON j) {
+        if (!hash_cons || failed) return j;
+        return *pool.insert(move(j)).first;
+    }
     JSON parse_literal(const string &expect, JSON res) {
-        auto iter = expect.begin();
-        while (iter != expect.end())
-            if (*(iter++) != src[i++]) break;
-        if (iter == expect.end()) return res;
-        fail("syntax error in parsing `" + expect + "`.");
-        return JSON();
+        // check before advancing, so a truncated literal stops at the end
+        for (char ch : expect) {
+            if (at(i) != ch) {
+                fail("syntax error in parsing `" + expect + "`.");
+                return JSON();
+            }
+            i++;
+        }
+        return res;
     }
     long encode_hex4() {
-        assert(src[i] == 'u');
-        if (src.length() - i < 4) {
+        assert(at(i) == 'u');
+        if (src_len - i < 5) {
             fail("no enough hex charactor for encode.");
             return -1;
         }
         i++;
+        long cp = 0;
         for (unsigned a = 0; a < 4; a++) {
-            if (!is_hex(src[i + a])) {
-                fail("invalid hex charactor " + format_char(src[i + a]) + ".");
+            char ch = at(i + a);
+            if (!is_hex(ch)) {
+                fail("invalid hex charactor " + format_char(ch) + ".");
                 return -1;
             }
+            cp = cp * 16 + (ch <= '9' ? ch - '0' : (ch | 0x20) - 'a' + 10);
         }
-        return strtol(src.substr(i, 4).data(), nullptr, 16);
+        return cp;
     }
     /**
      * from json11
@@ -215,39 +789,39 @@ struct ClvtParser final {
     }
 
     JSON parse_object() {
-        assert(src[i] == '{');
+        assert(at(i) == '{');
         i++;
         map<string, JSON> o;
         while (true) {
             skip_whitespace();
-            if (src[i] == '}') {
+            if (at(i) == '}') {
                 i++;
                 return o;
             }
-            if (src[i] != '"') {
+            if (at(i) != '"') {
                 fail("expect a string as key in JSON object.");
                 return JSON();
             }
-            JSON k = parse_string();
-            if (failed) return JSON();
+            if (!parse_raw_string()) return JSON();
+            string k = buf;
             skip_whitespace();
-            if (src[i] != ':') {
+            if (at(i) != ':') {
                 fail(
                     "expect a `:` to separate key and value in JSON object, "
                     "but got a " +
-                    format_char(src[i]) + ".");
+                    format_char(at(i)) + ".");
                 return JSON();
             }
             i++;
             skip_whitespace();
             JSON v = parse_json();
             if (failed) return JSON();
-            o.insert({std::move(k.string_value()), v});
+            o.emplace(move(k), move(v));
             skip_whitespace();
-            if (src[i] != ',') {
-                if (src[i] != '}') {
+            if (at(i) != ',') {
+                if (at(i) != '}') {
                     fail("expect a comma in object, but got a " +
-                         format_char(src[i]) + ".");
+                         format_char(at(i)) + ".");
                     return JSON();
                 }
                 i++;
@@ -261,82 +835,115 @@ struct ClvtParser final {
     }
 
     JSON parse_array() {
-        assert(src[i] == '[');
+        assert(at(i) == '[');
         i++;
-        vector<JSON> vec;
+        // elements go to the shared stack, nested arrays push above them
+        size_t base = stack.size();
         while (true) {
             skip_whitespace();
-            if (src[i] == ']') {
+            if (at(i) == ']') {
                 i++;
-                return vec;
+                return pop_array(base);
             }
-            JSON j = parse_json();
-            vec.push_back(j);
+            stack.push_back(parse_json());
+            if (failed) return JSON();
             skip_whitespace();
-            if (src[i] == ',')
+            if (at(i) == ',')
                 i++;
             else {
-                if (src[i] != ']') {
+                if (at(i) != ']') {
                     fail("need a comma.");
                     return JSON();
                 }
                 i++;
-                return vec;
+                return pop_array(base);
             }
         }
         assert(0);
         return JSON();
     }
 
+    JSON pop_array(size_t base) {
+        JSON::array a(std::make_move_iterator(stack.begin() + base),
+                      std::make_move_iterator(stack.end()));
+        stack.resize(base);
+        return a;
+    }
+
     JSON parse_string() {
-        assert(src[i] == '"');
+        if (!parse_raw_string()) return JSON();
+        return buf;
+    }
+
+    // decode a string into buf, return false on failure
+    bool parse_raw_string() {
+        assert(at(i) == '"');
         i++;
-        string res = "";
+        buf.clear();
         while (true) {
-            if (i == src.size()) {
+            // copy plain characters in bulk, checking them on the way
+            size_t end;
+            if (validate_utf8) {
+                bool bad = false;
+                end = scan_string_utf8(src, i, src_len, bad);
+                if (bad) {
+                    fail("invalid UTF-8 sequence in string.");
+                    return false;
+                }
+            } else {
+                end = scan_string(src, i, src_len);
+            }
+            buf.append(src + i, end - i);
+            i = end;
+            if (i == src_len) {
                 fail("unexpected end of input string.");
-                return JSON();
+                return false;
             }
-            char ch = src[i++];
+            char ch = at(i++);
             if (ch == '"') {
-                return res;
+                return true;
             } else if (ch == '\\') {
-                switch (src[i]) {
+                switch (at(i)) {
                     case '"':
                     case '\\':
                     case '/':
-                        res += src[i++];
+                        buf += at(i++);
                         break;
                     case 'b':
                         i++;
-                        res += '\b';
+                        buf += '\b';
                         break;
                     case 'f':
                         i++;
-                        res += '\f';
+                        buf += '\f';
                         break;
                     case 'n':
                         i++;
-                        res += '\n';
+                        buf += '\n';
                         break;
                     case 'r':
                         i++;
-                        res += '\r';
+                        buf += '\r';
                         break;
                     case 't':
                         i++;
-                        res += '\t';
+                        buf += '\t';
                         break;
                     case 'u':
                         long cp = encode_hex4();
                         if (cp < 0) {
-                            return JSON();
+                            return false;
                         }
                         i += 4;
+                        if (validate_utf8 && cp >= 0xDC00 && cp <= 0xDFFF) {
+                            fail("unpaired low surrogate " +
+                                 std::to_string(cp) + ".");
+                            return false;
+                        }
                         if (cp >= 0xD800 && cp <= 0xDBFF) {
-                            if (src[i] != '\\' || src[i + 1] != 'u') {
+                            if (at(i) != '\\' || at(i + 1) != 'u') {
                                 fail("expect a surrogate pair but not get.");
-                                return JSON();
+                                return false;
                             }
                             i++;
                             long cp2 = encode_hex4();
@@ -344,16 +951,14 @@ struct ClvtParser final {
                                 fail("invalid surrogate pair with " +
                                      std::to_string(cp) + " and " +
                                      std::to_string(cp2));
-                                return JSON();
+                                return false;
                             }
                             cp = (((cp - 0xD800) << 10) | (cp2 - 0xDC00)) +
                                  0x10000;
                         }
-                        encode_utf8(cp, res);
+                        encode_utf8(cp, buf);
                         break;
                 }
-            } else {
-                res += ch;
             }
         }
     }
@@ -362,48 +967,50 @@ struct ClvtParser final {
         // start position
         size_t sp = i;
         // prefix +/-
-        if (src[i] == '-' || src[i] == '+') i++;
+        if (at(i) == '-' || at(i) == '+') i++;
         // integer part
-        if (src[i] == '0') {
+        if (at(i) == '0') {
             i++;
-            if (IS_DIGIT(src[i])) {
+            if (IS_DIGIT(at(i))) {
                 fail("leading 0(s) not permitted in numbers.");
                 return JSON();
             }
-        } else if (IS_INTEGER(src[i])) {
+        } else if (IS_INTEGER(at(i))) {
             i++;
-            while (IS_DIGIT(src[i])) i++;
+            while (IS_DIGIT(at(i))) i++;
         } else {
-            fail("invalid charactor " + format_char(src[i]) + " in numbers.");
+            fail("invalid charactor " + format_char(at(i)) + " in numbers.");
             return JSON();
         }
         // fraction part
-        if (src[i] == '.') {
+        if (at(i) == '.') {
             i++;
-            if (!IS_DIGIT(src[i])) {
+            if (!IS_DIGIT(at(i))) {
                 fail("at least a decimal required in fractional part.");
                 return JSON();
             }
-            while (IS_DIGIT(src[i])) i++;
+            while (IS_DIGIT(at(i))) i++;
         }
 
         // exponent part
-        if (src[i] == 'e' || src[i] == 'E') {
+        if (at(i) == 'e' || at(i) == 'E') {
             i++;
-            if (src[i] == '-' || src[i] == '+') i++;
-            if (!IS_DIGIT(src[i])) {
+            if (at(i) == '-' || at(i) == '+') i++;
+            if (!IS_DIGIT(at(i))) {
                 fail("at least a decimal required in exponential part.");
                 return JSON();
             }
-            while (IS_DIGIT(src[i])) i++;
+            while (IS_DIGIT(at(i))) i++;
         }
-        return strtod(src.c_str() + sp, nullptr);
+        // strtod needs a terminated string
+        buf.assign(src + sp, i - sp);
+        return strtod(buf.c_str(), nullptr);
     }
 
     JSON parse_json() {
         skip_whitespace();
-        while (i != src.size()) {
-            switch (src[i]) {
+        while (i != src_len) {
+            switch (at(i)) {
                 case 'n':
                     return parse_literal("null", JSON());
                 case 'f':
@@ -411,33 +1018,102 @@ struct ClvtParser final {
                 case 't':
                     return parse_literal("true", true);
                 case '"':
-                    return parse_string();
+                    return intern(parse_string());
                 case '[':
-                    return parse_array();
+                    return intern(parse_array());
                 case '{':
                     // std::cout << src << std::endl;
-                    return parse_object();
+                    return intern(parse_object());
                 default:
-                    return parse_number();
+                    return intern(parse_number());
             }
         }
-        CLVT_ASSERT(0);
+        fail("unexpected end of input.");
         return JSON();
     }
     void skip_whitespace() {
-        while (src[i] == ' ' || src[i] == '\n' || src[i] == '\r' ||
-               src[i] == '\t')
+        while (at(i) == ' ' || at(i) == '\n' || at(i) == '\r' ||
+               at(i) == '\t')
             i++;
     }
 };
 
-JSON JSON::parse(const string &in, string &err) {
-    ClvtParser cp{in, 0, false, err};
-    JSON res = cp.parse_json();
-    cp.skip_whitespace();
-    if (cp.failed) return JSON();
-    if (cp.i != in.size()) return JSON();
+JSON JSON::parse(const string &in, string &err, int opts) {
+    ClvtParser cp(opts);
+    JSON res = cp.parse_document(in.data(), in.size());
+    if (cp.failed) err = move(cp.err);
+    return res;
+}
+
+JSON JSON::parse(const char *in, string &err, int opts) {
+    if (!in) {
+        err = "null pointer.";
+        return nullptr;
+    }
+    ClvtParser cp(opts);
+    JSON res = cp.parse_document(in, strlen(in));
+    if (cp.failed) err = move(cp.err);
+    return res;
+}
+
+JSON JSON::parse(const char *in, size_t n, string &err, int opts) {
+    ClvtParser cp(opts);
+    JSON res = cp.parse_document(in, n);
+    if (cp.failed) err = move(cp.err);
     return res;
 }
 
+JSONParser::JSONParser(int opts) : p(new ClvtParser(opts)) {}
+JSONParser::~JSONParser() {}
+
+JSON JSONParser::parse(const string &in, string &err) {
+    JSON res = p->parse_document(in.data(), in.size());
+    if (p->failed) err.swap(p->err);
+    return res;
+}
+
+size_t JSONParser::parse_many(const string *in, size_t n, JSON *out,
+                              string *errs) {
+    size_t ok = 0;
+    for (size_t k = 0; k < n; k++) {
+        out[k] = p->parse_document(in[k].data(), in[k].size());
+        if (!p->failed) {
+            ok++;
+            if (errs) errs[k].clear();
+        } else if (errs) {
+            errs[k].swap(p->err);
+        }
+    }
+    return ok;
+}
+
+JSON JSONParser::parse(const char *in, size_t n, string &err) {
+    JSON res = p->parse_document(in, n);
+    if (p->failed) err.swap(p->err);
+    return res;
+}
+
+size_t JSONParser::parse_many(const input *in, size_t n, JSON *out,
+                              string *errs) {
+    size_t ok = 0;
+    for (size_t k = 0; k < n; k++) {
+        out[k] = p->parse_document(in[k].first, in[k].second);
+        if (!p->failed) {
+            ok++;
+            if (errs) errs[k].clear();
+        } else if (errs) {
+            errs[k].swap(p->err);
+        }
+    }
+    return ok;
+}
+
+vector<JSON> JSONParser::parse_many(const vector<string> &in,
+                                    vector<string> *errs) {
+    vector<JSON> out(in.size());
+    if (errs) errs->resize(in.size());
+    parse_many(in.data(), in.size(), out.data(), errs ? errs->data() : nullptr);
+    return out;
+}
+
 }  // namespace clavata
\ No newline at end of file
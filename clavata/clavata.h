@@ -1,10 +1,12 @@
 #ifndef _CLAVATA_H__
 #define _CLAVATA_H__
 
+#include <cstddef>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 using std::map;
@@ -15,10 +17,20 @@ using std::vector;
 namespace clavata {
 
 class JSONValue;
+struct ClvtParser;
 
 class JSON final {
    public:
     enum Type { kNULL, kNUMBER, kBOOL, kSTRING, kARRAY, kOBJECT };
+    // parse options, can be or-ed together
+    enum ParseOption {
+        kPARSE_DEFAULT = 0,
+        // share identical subtrees (strings, numbers, arrays, objects)
+        // among the parsed document
+        kPARSE_HASH_CONS = 1 << 0,
+        // reject strings that are not well-formed UTF-8
+        kPARSE_VALIDATE_UTF8 = 1 << 1,
+    };
     typedef vector<JSON> array;
     typedef map<string, JSON> object;
 
@@ -60,20 +72,59 @@ class JSON final {
     const JSON &operator[](const string &) const;
     // const JSON &operator[](const char *) const;
 
-    static JSON parse(const string &, string &);
-    static JSON parse(const char *in, string &err) {
-        if (in) {
-            return parse(string(in), err);
-        } else {
-            err = "null pointer.";
-            return nullptr;
-        }
-    }
+    // deep comparison, returns at once if both share the same value
+    bool operator==(const JSON &) const;
+    bool operator!=(const JSON &rhs) const { return !(*this == rhs); }
+    // structural hash, equal values give equal hashes
+    size_t hash() const;
+
+    // err is only written on failure. see JSONParser to parse many inputs
+    static JSON parse(const string &, string &, int opts = kPARSE_DEFAULT);
+    static JSON parse(const char *, string &, int opts = kPARSE_DEFAULT);
+    // in[0, n), in need not be terminated
+    static JSON parse(const char *in, size_t n, string &,
+                      int opts = kPARSE_DEFAULT);
 
    private:
+    friend struct ClvtParser;
     shared_ptr<JSONValue> m;
 };
 
+/**
+ * a parser that can be used again and again. its scratch buffers keep their
+ * capacity between inputs, which pays off for many small messages.
+ * not thread safe, use one per thread.
+ */
+class JSONParser final {
+   public:
+    explicit JSONParser(int opts = JSON::kPARSE_DEFAULT);
+    ~JSONParser();
+    JSONParser(const JSONParser &) = delete;
+    JSONParser &operator=(const JSONParser &) = delete;
+
+    // data and length of an input, it need not be terminated
+    typedef std::pair<const char *, size_t> input;
+
+    // same as JSON::parse
+    JSON parse(const string &, string &);
+    JSON parse(const char *in, size_t n, string &);
+    /**
+     * parse in[0, n) into out[0, n). a failed input gives null, and its
+     * message in errs[k] if errs is given (errs[k] is cleared on success).
+     * return the number of inputs parsed successfully.
+     */
+    size_t parse_many(const string *in, size_t n, JSON *out,
+                      string *errs = nullptr);
+    // the same over buffers in place, e.g. messages in a receive buffer
+    size_t parse_many(const input *in, size_t n, JSON *out,
+                      string *errs = nullptr);
+    vector<JSON> parse_many(const vector<string> &in,
+                            vector<string> *errs = nullptr);
+
+   private:
+    std::unique_ptr<ClvtParser> p;
+};
+
 class JSONValue {
     friend class JSON;
 
@@ -88,9 +139,19 @@ class JSONValue {
     virtual const JSON::object &object_items() const;
     virtual const JSON &operator[](const string &) const;
     // virtual const JSON &operator[](const char *) const;
+    // `other` is guaranteed to have the same type()
+    virtual bool equals(const JSONValue *other) const = 0;
+    virtual size_t hash() const = 0;
     virtual ~JSONValue() {}
 };
 
 }  // namespace clavata
 
+namespace std {
+template <>
+struct hash<clavata::JSON> {
+    size_t operator()(const clavata::JSON &j) const { return j.hash(); }
+};
+}  // namespace std
+
 #endif  // _CLAVATA_H__
\ No newline at end of file
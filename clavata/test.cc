@@ -1,5 +1,6 @@
 #include "clavata.h"
 using namespace clavata;
+#include <cmath>
 #include <cstdio>
 #include <cstring>
 #include <iomanip>
@@ -168,12 +169,203 @@ void test_object() {
         " } ");
 }
 
+void test_equal() {
+    string err;
+    const char *json =
+        "{ \"a\" : [ 1, -0, \"x\", null, true ], \"o\" : { \"k\" : [ ] } }";
+    JSON lhs = JSON::parse(json, err);
+    JSON rhs = JSON::parse(json, err);
+    CLVT_EQ_INT(true, lhs == lhs);
+    CLVT_EQ_INT(true, lhs == rhs);
+    CLVT_EQ_INT(true, lhs.hash() == rhs.hash());
+    // both hashes are cached now and checked before the deep comparison
+    CLVT_EQ_INT(true, lhs == rhs);
+    CLVT_EQ_INT(true, JSON(0.0) == JSON(-0.0));
+    CLVT_EQ_INT(true, JSON(0.0).hash() == JSON(-0.0).hash());
+    CLVT_EQ_INT(true, JSON() != JSON(false));
+    CLVT_EQ_INT(true, JSON(JSON::array{}) != JSON(JSON::object{}));
+    JSON other = JSON::parse("{ \"a\" : [ 1, 0, \"x\", null, false ] }", err);
+    CLVT_EQ_INT(true, lhs != other);
+    CLVT_EQ_INT(true, lhs["a"] != other["a"]);
+}
+
+void test_hash_cons() {
+    string err;
+    const char *json =
+        "[ { \"id\" : [ 1, 2 ] }, { \"id\" : [ 1, 2 ] }, \"s\", \"s\" ]";
+    JSON res = JSON::parse(json, err);
+    CLVT_EQ_INT(false, &res[0].object_items() == &res[1].object_items());
+    res = JSON::parse(json, err, JSON::kPARSE_HASH_CONS);
+    CLVT_EQ_TYPE(JSON::kARRAY, res);
+    CLVT_EQ_INT(true, &res[0].object_items() == &res[1].object_items());
+    CLVT_EQ_INT(true, &res[2].string_value() == &res[3].string_value());
+    CLVT_EQ_INT(true, res == JSON::parse(json, err));
+    // -0 equals 0 but must keep its sign
+    res = JSON::parse("[ 0, -0, 0 ]", err, JSON::kPARSE_HASH_CONS);
+    CLVT_EQ_INT(false, (bool)std::signbit(res[0].number_value()));
+    CLVT_EQ_INT(true, (bool)std::signbit(res[1].number_value()));
+    CLVT_EQ_INT(false, (bool)std::signbit(res[2].number_value()));
+    res = JSON::parse("[ { \"a\" : -0 }, { \"a\" : 0 } ]", err,
+                      JSON::kPARSE_HASH_CONS);
+    CLVT_EQ_INT(true, (bool)std::signbit(res[0]["a"].number_value()));
+    CLVT_EQ_INT(false, (bool)std::signbit(res[1]["a"].number_value()));
+}
+
+#define TEST_UTF8(expect, json)                                              \
+    do {                                                                     \
+        err.clear();                                                         \
+        res = JSON::parse(json, err, JSON::kPARSE_VALIDATE_UTF8);            \
+        CLVT_EQ_TYPE(JSON::kSTRING, res);                                    \
+        CLVT_EQ_INT((int)sizeof expect - 1, (int)res.string_value().size()); \
+        CLVT_EQ_STRING(expect, res.string_value());                          \
+    } while (0)
+
+#define TEST_UTF8_ERROR(json)                                     \
+    do {                                                          \
+        err.clear();                                              \
+        res = JSON::parse(json, err, JSON::kPARSE_VALIDATE_UTF8); \
+        CLVT_EQ_TYPE(JSON::kNULL, res);                           \
+        CLVT_EQ_INT(false, err.empty());                          \
+    } while (0)
+
+void test_utf8() {
+    string err;
+    JSON res;
+    TEST_UTF8("\xC2\xA2", "\"\xC2\xA2\"");
+    TEST_UTF8("\xE2\x82\xAC", "\"\xE2\x82\xAC\"");
+    TEST_UTF8("\xF0\x9D\x84\x9E", "\"\xF0\x9D\x84\x9E\"");
+    TEST_UTF8("\xED\x9F\xBF\xEE\x80\x80\xF4\x8F\xBF\xBF",
+              "\"\xED\x9F\xBF\xEE\x80\x80\xF4\x8F\xBF\xBF\"");
+    // long enough to go through the vectorized scan
+    TEST_UTF8(
+        "0123456789abcdef0123456789abcdef0123456789\xE2\x82\xAC"
+        "abcdef0123456789\n\xC2\xA2",
+        "\"0123456789abcdef0123456789abcdef0123456789\xE2\x82\xAC"
+        "abcdef0123456789\\n\xC2\xA2\"");
+    TEST_UTF8_ERROR("\"\x80\"");             /* lone continuation byte */
+    TEST_UTF8_ERROR("\"\xC0\xAF\"");         /* overlong */
+    TEST_UTF8_ERROR("\"\xE0\x80\xAF\"");     /* overlong */
+    TEST_UTF8_ERROR("\"\xED\xA0\x80\"");     /* surrogate */
+    TEST_UTF8_ERROR("\"\xF4\x90\x80\x80\""); /* above U+10FFFF */
+    TEST_UTF8_ERROR("\"\xF5\x80\x80\x80\"");
+    TEST_UTF8_ERROR("\"\xE2\x82\"");         /* truncated */
+    TEST_UTF8_ERROR("\"\xE2\x82");
+    TEST_UTF8_ERROR("\"\\uDC00\"");          /* unpaired low surrogate */
+    TEST_UTF8_ERROR("\"0123456789abcdef0123456789abcdef\xFF\"");
+    // sequences across 16 and 32 byte blocks
+    TEST_UTF8("0123456789abcd\xE2\x82\xAC"
+              "0123456789abc\xF0\x9D\x84\x9E",
+              "\"0123456789abcd\xE2\x82\xAC"
+              "0123456789abc\xF0\x9D\x84\x9E\"");
+    TEST_UTF8_ERROR("\"0123456789abcd\xE2\x82\"");
+    TEST_UTF8_ERROR("\"0123456789abcdef0123456789abcd\xF0\x9D\x84\"");
+    TEST_UTF8_ERROR("\"0123456789abcd\xE2\x82\\n\"");
+    // bytes after the closing quote belong to the next value
+    err.clear();
+    res = JSON::parse("[ \"0123456789abc\", \"\xE2\x82\xAC\" ]", err,
+                      JSON::kPARSE_VALIDATE_UTF8);
+    CLVT_EQ_TYPE(JSON::kARRAY, res);
+    CLVT_EQ_STRING("\xE2\x82\xAC", res[1].string_value());
+    // not checked by default
+    TEST_STRING("\xC0\xAF", "\"\xC0\xAF\"");
+}
+
+void test_parser() {
+    string err;
+    JSONParser parser(JSON::kPARSE_HASH_CONS);
+    JSON res = parser.parse("[ 1, [ 2, [ 3 ] ], \"a\" ]", err);
+    CLVT_EQ_TYPE(JSON::kARRAY, res);
+    CLVT_EQ_INT(3, (int)res.array_items().size());
+    CLVT_EQ_INT(2, (int)res[1].array_items().size());
+    CLVT_EQ_DOUBLE(3.0, res[1][1][0].number_value());
+    // a failure in a nested array must not leak into the next input
+    res = parser.parse("[ 1, [ 2, x ] ]", err);
+    CLVT_EQ_TYPE(JSON::kNULL, res);
+    CLVT_EQ_INT(false, err.empty());
+    res = parser.parse("[ \"b\", \"b\" ]", err);
+    CLVT_EQ_TYPE(JSON::kARRAY, res);
+    CLVT_EQ_INT(2, (int)res.array_items().size());
+    CLVT_EQ_INT(true, &res[0].string_value() == &res[1].string_value());
+    CLVT_EQ_INT(true, res == JSON::parse("[ \"b\", \"b\" ]", err));
+
+    // a big document, then small ones: each document has its own pool
+    string json = "[";
+    for (int k = 0; k < 1000; k++) json += "\"s" + std::to_string(k) + "\", ";
+    json += "\"s0\" ]";
+    JSON big = parser.parse(json, err);
+    CLVT_EQ_INT(1001, (int)big.array_items().size());
+    CLVT_EQ_INT(true, &big[0].string_value() == &big[1000].string_value());
+    res = parser.parse("[ \"s0\", \"s0\" ]", err);
+    CLVT_EQ_INT(true, &res[0].string_value() == &res[1].string_value());
+    CLVT_EQ_INT(false, &res[0].string_value() == &big[0].string_value());
+
+    // truncated literals must not read past the end of the input
+    const char *truncated[] = {"n", "tru", "[nul"};
+    for (auto json : truncated) {
+        err.clear();
+        res = parser.parse(json, err);
+        CLVT_EQ_TYPE(JSON::kNULL, res);
+        CLVT_EQ_INT(false, err.empty());
+        err.clear();
+        res = JSON::parse(json, err);
+        CLVT_EQ_TYPE(JSON::kNULL, res);
+        CLVT_EQ_INT(false, err.empty());
+    }
+
+    vector<string> in = {"{ \"k\" : [ 1 ] }", "[ 1,", "\"s\"", "1 2", "null"};
+    vector<string> errs;
+    vector<JSON> out = parser.parse_many(in, &errs);
+    CLVT_EQ_INT(5, (int)out.size());
+    CLVT_EQ_INT(5, (int)errs.size());
+    CLVT_EQ_DOUBLE(1.0, out[0]["k"][0].number_value());
+    CLVT_EQ_TYPE(JSON::kNULL, out[1]);
+    CLVT_EQ_INT(false, errs[1].empty());
+    CLVT_EQ_STRING("s", out[2].string_value());
+    CLVT_EQ_INT(true, errs[2].empty());
+    CLVT_EQ_TYPE(JSON::kNULL, out[3]);
+    CLVT_EQ_INT(false, errs[3].empty());
+    CLVT_EQ_TYPE(JSON::kNULL, out[4]);
+    CLVT_EQ_INT(true, errs[4].empty());
+    JSON arr[5];
+    CLVT_EQ_INT(3, (int)parser.parse_many(in.data(), in.size(), arr));
+
+    // messages in place, a span must not be read past its end
+    const char msgs[] = "[ 1, 2 ]{ \"k\" : \"v\" }1234nul";
+    JSONParser::input spans[] = {
+        {msgs, 8}, {msgs + 8, 13}, {msgs + 21, 2}, {msgs + 25, 3}};
+    CLVT_EQ_INT(3, (int)parser.parse_many(spans, 4, arr, errs.data()));
+    CLVT_EQ_INT(2, (int)arr[0].array_items().size());
+    CLVT_EQ_STRING("v", arr[1]["k"].string_value());
+    CLVT_EQ_DOUBLE(12.0, arr[2].number_value());
+    CLVT_EQ_TYPE(JSON::kNULL, arr[3]);
+    CLVT_EQ_INT(false, errs[3].empty());
+    // exact size buffers, so that an address sanitizer sees any over-read
+    const char *unterminated[] = {"n", "tru", "[nul", "\"ab", "\"\\u12",
+                                  "-1.5e", "{ \"k\" :", "[ 1, 2"};
+    for (auto json : unterminated) {
+        vector<char> v(json, json + strlen(json));
+        err.clear();
+        res = JSON::parse(v.data(), v.size(), err, JSON::kPARSE_VALIDATE_UTF8);
+        CLVT_EQ_TYPE(JSON::kNULL, res);
+        CLVT_EQ_INT(false, err.empty());
+    }
+    vector<char> v(msgs, msgs + 21);
+    res = parser.parse(v.data(), v.size(), err);
+    CLVT_EQ_TYPE(JSON::kNULL, res);
+    res = parser.parse(v.data() + 8, 13, err);
+    CLVT_EQ_TYPE(JSON::kOBJECT, res);
+}
+
 void test() {
     test_literal();
     test_number();
     test_string();
     test_array();
     test_object();
+    test_equal();
+    test_hash_cons();
+    test_utf8();
+    test_parser();
 }
 int main() {
     test();